@@ -55,6 +55,11 @@ card *stack_back(stack_t *s);
 card *stack_at(stack_t *s, int index);
 void stack_insert(stack_t *s, int index, card c);
 void stack_erase(stack_t *s, int index);
+void reveal_tops(void);
+int  run_command(char com, int from, int to, int loc1, int loc2);
+stack_t *pile_at(int pile);
+int  get_pile(int pile, int *values, int *visible);
+void set_pile(int pile, const int *values, const int *visible, int size);
 
 /* --- Utility functions to get suit and value --- */
 int get_suit(int t) {
@@ -233,6 +238,186 @@ void display(int code) {
     }
 }
 
+/* --- Make the top card of every stack and of the deck visible --- */
+void reveal_tops(void) {
+    int x;
+    for (x = 0; x < 6; x++) {
+        if (stacks[x].size > 0) {
+            stack_back(&stacks[x])->visible = true;
+        }
+    }
+    if (deck.size > 0) {
+        stack_back(&deck)->visible = true;
+    }
+}
+
+/* --- Carry out one command, returning the code for display_code --- */
+int run_command(char com, int from, int to, int loc1, int loc2) {
+    int code = 0;
+
+    if (com == 'm') {
+        /* Move top card from "from" stack to "to" stack if valid */
+        if (from >= 0 && from < 6 && to >= 0 && to < 6 &&
+            stacks[from].size > 0 && stacks[to].size > 0) {
+            card *c1 = stack_back(&stacks[from]);
+            card *c2 = stack_back(&stacks[to]);
+            if (c1 && c2) {
+                if (((get_suit(c1->value) + 1) % 2) == (get_suit(c2->value) % 2)) {
+                    if (get_num(c2->value) - get_num(c1->value) == 1) {
+                        card moved = pop_card(&stacks[from]);
+                        moved.visible = true;
+                        push_card(&stacks[to], moved);
+                    } else {
+                        code = 1;
+                    }
+                } else {
+                    code = 2;
+                }
+            }
+        }
+    }
+    else if (com == 'M') {
+        /* A run cannot go into its own stack: the loop would never end */
+        if (from >= 0 && from < 6 && to >= 0 && to < 6 && from != to &&
+            loc1 >= 0 && loc1 < stacks[from].size &&
+            loc2 >= 0 && loc2 < stacks[to].size) {
+            card *pc1 = &stacks[from].cards[loc1];
+            card *pc2 = &stacks[to].cards[loc2];
+            if (((get_suit(pc1->value) + 1) % 2) == (get_suit(pc2->value) % 2)) {
+                if (get_num(pc2->value) - get_num(pc1->value) == 1) {
+                    /* Move from [loc1..end] to position loc2 in the 'to' stack */
+                    while (stacks[from].size > loc1) {
+                        card f = stacks[from].cards[loc1];
+                        stack_insert(&stacks[to], loc2, f);
+                        stack_erase(&stacks[from], loc1);
+                    }
+                }
+            }
+        }
+    }
+    else if (com == 'n') {
+        /* Rotate deck (top card goes to bottom) */
+        if (deck.size > 0) {
+            card v = pop_card(&deck);
+            stack_insert(&deck, 0, v);
+        }
+    }
+    else if (com == 'p') {
+        if (to >= 0 && to < 6 && deck.size > 0 && stacks[to].size > 0) {
+            card *pc1 = stack_back(&deck);
+            card *pc2 = stack_back(&stacks[to]);
+            if (pc1 && pc2) {
+                if (((get_suit(pc1->value) + 1) % 2) == (get_suit(pc2->value) % 2)) {
+                    if (get_num(pc2->value) - get_num(pc1->value) == 1) {
+                        card moved = pop_card(&deck);
+                        moved.visible = true;
+                        push_card(&stacks[to], moved);
+                    } else {
+                        code = 4;
+                    }
+                } else {
+                    code = 3;
+                }
+            }
+        }
+    }
+    else if (com == 'P') {
+        if (from >= 0 && from < 6 && to >= 0 && to < 4 && stacks[from].size > 0) {
+            card *c1 = stack_back(&stacks[from]);
+            if (c1) {
+                /* If final stack empty, accept only A(1) */
+                if (final_stacks[to].size == 0) {
+                    if (get_num(c1->value) == 1) {
+                        card moved = pop_card(&stacks[from]);
+                        push_card(&final_stacks[to], moved);
+                    }
+                } else {
+                    card *c2 = stack_back(&final_stacks[to]);
+                    if (c2) {
+                        if (get_num(c1->value) == get_num(c2->value) + 1 &&
+                            get_suit(c1->value) == get_suit(c2->value)) {
+                            card moved = pop_card(&stacks[from]);
+                            push_card(&final_stacks[to], moved);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    else if (com == 'Q') {
+        /* Move from deck to final stack */
+        if (to >= 0 && to < 4 && deck.size > 0) {
+            card *c1 = stack_back(&deck);
+            if (c1) {
+                if (final_stacks[to].size == 0) {
+                    if (get_num(c1->value) == 1) {
+                        card moved = pop_card(&deck);
+                        push_card(&final_stacks[to], moved);
+                    }
+                } else {
+                    card *c2 = stack_back(&final_stacks[to]);
+                    if (c2) {
+                        if ((get_num(c1->value) == get_num(c2->value) + 1) &&
+                            (get_suit(c1->value) == get_suit(c2->value))) {
+                            card moved = pop_card(&deck);
+                            push_card(&final_stacks[to], moved);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    reveal_tops();
+    return code;
+}
+
+/*
+ * Piles by number, for programs that drive the game without main():
+ * 0 is the deck, 1..6 the stacks and 7..10 the final stacks.
+ */
+stack_t *pile_at(int pile) {
+    if (pile == 0) {
+        return &deck;
+    }
+    if (pile >= 1 && pile <= 6) {
+        return &stacks[pile - 1];
+    }
+    if (pile >= 7 && pile <= 10) {
+        return &final_stacks[pile - 7];
+    }
+    return (stack_t*)0;
+}
+
+/* --- Copy a pile out as plain ints, returning its size --- */
+int get_pile(int pile, int *values, int *visible) {
+    stack_t *s = pile_at(pile);
+    int i;
+    if (!s) return 0;
+    for (i = 0; i < s->size; i++) {
+        values[i]  = s->cards[i].value;
+        visible[i] = s->cards[i].visible;
+    }
+    return s->size;
+}
+
+/* --- Replace a pile with the given cards --- */
+void set_pile(int pile, const int *values, const int *visible, int size) {
+    stack_t *s = pile_at(pile);
+    int i;
+    if (!s) return;
+    s->size = 0;
+    for (i = 0; i < size; i++) {
+        card c;
+        c.value   = values[i];
+        c.visible = visible[i] ? true : false;
+        push_card(s, c);
+    }
+}
+
+/* Build with -DANSI_SOLITAIRE_LIBRARY to link the game into another program */
+#ifndef ANSI_SOLITAIRE_LIBRARY
+
 /* --- MAIN --- */
 int main(void) {
     int t, x;
@@ -286,39 +471,22 @@ int main(void) {
 
         {
             char com;
+            int from = 0, to = 0, loc1 = 0, loc2 = 0;
+            int before = deck.size;
+
             if (scanf(" %c", &com) != 1) {
                 /* If user input fails, just continue */
                 continue;
             }
 
-            if (com == 'm') {
-                int from, to;
+            if (com == 'm' || com == 'P') {
                 printf(">>");
                 fflush(stdout);
                 if (scanf(" %d %d", &from, &to) != 2) {
                     continue;
                 }
-                /* Move top card from "from" stack to "to" stack if valid */
-                if (stacks[from].size > 0 && stacks[to].size > 0) {
-                    card *c1 = stack_back(&stacks[from]);
-                    card *c2 = stack_back(&stacks[to]);
-                    if (c1 && c2) {
-                        if (((get_suit(c1->value) + 1) % 2) == (get_suit(c2->value) % 2)) {
-                            if (get_num(c2->value) - get_num(c1->value) == 1) {
-                                card moved = pop_card(&stacks[from]);
-                                moved.visible = true;
-                                push_card(&stacks[to], moved);
-                            } else {
-                                code = 1;
-                            }
-                        } else {
-                            code = 2;
-                        }
-                    }
-                }
             }
             else if (com == 'M') {
-                int from, to;
                 printf(">>");
                 fflush(stdout);
                 if (scanf(" %d %d", &from, &to) != 2) {
@@ -326,161 +494,57 @@ int main(void) {
                 }
                 printf("\n");
 
-                /* Display indexes in 'from' stack */
-                for (t = 0; t < stacks[from].size; t++) {
-                    printf("%d    ", t);
-                }
-                printf("\n");
-                /* Display cards in 'from' stack */
-                for (t = 0; t < stacks[from].size; t++) {
-                    char buf[16];
-                    display_card(&stacks[from].cards[t], buf, sizeof(buf));
-                    printf("%s ", buf);
-                }
-                printf("\n\n");
-
-                /* Display indexes in 'to' stack */
-                for (t = 0; t < stacks[to].size; t++) {
-                    printf("%d    ", t);
-                }
-                printf("\n");
-                /* Display cards in 'to' stack */
-                for (t = 0; t < stacks[to].size; t++) {
-                    char buf[16];
-                    display_card(&stacks[to].cards[t], buf, sizeof(buf));
-                    printf("%s ", buf);
-                }
-                printf("\n");
-
-                {
-                    int loc1, loc2;
-                    printf(">>");
-                    fflush(stdout);
-                    if (scanf(" %d %d", &loc1, &loc2) != 2) {
-                        continue;
+                if (from >= 0 && from < 6 && to >= 0 && to < 6) {
+                    /* Display indexes in 'from' stack */
+                    for (t = 0; t < stacks[from].size; t++) {
+                        printf("%d    ", t);
                     }
-
-                    if (loc1 >= 0 && loc1 < stacks[from].size &&
-                        loc2 >= 0 && loc2 < stacks[to].size) {
-                        card *pc1 = &stacks[from].cards[loc1];
-                        card *pc2 = &stacks[to].cards[loc2];
-                        if (((get_suit(pc1->value) + 1) % 2) == (get_suit(pc2->value) % 2)) {
-                            if (get_num(pc2->value) - get_num(pc1->value) == 1) {
-                                /* Move from [loc1..end] to position loc2 in the 'to' stack */
-                                while (stacks[from].size > loc1) {
-                                    card f = stacks[from].cards[loc1];
-                                    stack_insert(&stacks[to], loc2, f);
-                                    stack_erase(&stacks[from], loc1);
-                                }
-                            }
-                        }
+                    printf("\n");
+                    /* Display cards in 'from' stack */
+                    for (t = 0; t < stacks[from].size; t++) {
+                        char buf[16];
+                        display_card(&stacks[from].cards[t], buf, sizeof(buf));
+                        printf("%s ", buf);
                     }
-                }
-            }
-            else if (com == 'n') {
-                /* Rotate deck (top card goes to bottom) */
-                if (deck.size > 0) {
-                    card v = pop_card(&deck);
-                    /* Insert at the front (deck.begin()) */
-                    if (deck.size < COUNT) {
-                        int i;
-                        for (i = deck.size; i > 0; i--) {
-                            deck.cards[i] = deck.cards[i - 1];
-                        }
-                        deck.cards[0] = v;
-                        deck.size++;
+                    printf("\n\n");
+
+                    /* Display indexes in 'to' stack */
+                    for (t = 0; t < stacks[to].size; t++) {
+                        printf("%d    ", t);
                     }
-                }
-            }
-            else if (com == 'p') {
-                int to;
-                printf(">");
-                fflush(stdout);
-                if (scanf(" %d", &to) != 1) {
-                    continue;
-                }
-                if (deck.size > 0 && stacks[to].size > 0) {
-                    card *pc1 = stack_back(&deck);
-                    card *pc2 = stack_back(&stacks[to]);
-                    if (pc1 && pc2) {
-                        if (((get_suit(pc1->value) + 1) % 2) == (get_suit(pc2->value) % 2)) {
-                            if (get_num(pc2->value) - get_num(pc1->value) == 1) {
-                                card moved = pop_card(&deck);
-                                moved.visible = true;
-                                push_card(&stacks[to], moved);
-                                printf("moved!");
-                            } else {
-                                code = 4;
-                            }
-                        } else {
-                            code = 3;
-                        }
+                    printf("\n");
+                    /* Display cards in 'to' stack */
+                    for (t = 0; t < stacks[to].size; t++) {
+                        char buf[16];
+                        display_card(&stacks[to].cards[t], buf, sizeof(buf));
+                        printf("%s ", buf);
                     }
+                    printf("\n");
                 }
-            }
-            else if (com == 'P') {
-                int from, to;
+
                 printf(">>");
                 fflush(stdout);
-                if (scanf(" %d %d", &from, &to) != 2) {
+                if (scanf(" %d %d", &loc1, &loc2) != 2) {
                     continue;
                 }
-                if (stacks[from].size > 0) {
-                    card *c1 = stack_back(&stacks[from]);
-                    if (c1) {
-                        /* If final stack empty, accept only A(1) */
-                        if (final_stacks[to].size == 0) {
-                            if (get_num(c1->value) == 1) {
-                                card moved = pop_card(&stacks[from]);
-                                push_card(&final_stacks[to], moved);
-                            }
-                        } else {
-                            card *c2 = stack_back(&final_stacks[to]);
-                            if (c2) {
-                                if (get_num(c1->value) == get_num(c2->value) + 1 &&
-                                    get_suit(c1->value) == get_suit(c2->value)) {
-                                    card moved = pop_card(&stacks[from]);
-                                    push_card(&final_stacks[to], moved);
-                                }
-                            }
-                        }
-                    }
-                }
             }
-            else if (com == 'Q') {
-                /* Move from deck to final stack */
-                int to;
+            else if (com == 'p' || com == 'Q') {
                 printf(">");
                 fflush(stdout);
                 if (scanf(" %d", &to) != 1) {
                     continue;
                 }
-                if (deck.size > 0) {
-                    card *c1 = stack_back(&deck);
-                    if (c1) {
-                        if (final_stacks[to].size == 0) {
-                            if (get_num(c1->value) == 1) {
-                                card moved = pop_card(&deck);
-                                push_card(&final_stacks[to], moved);
-                            }
-                        } else {
-                            card *c2 = stack_back(&final_stacks[to]);
-                            if (c2) {
-                                if ((get_num(c1->value) == get_num(c2->value) + 1) &&
-                                    (get_suit(c1->value) == get_suit(c2->value))) {
-                                    card moved = pop_card(&deck);
-                                    push_card(&final_stacks[to], moved);
-                                }
-                            }
-                        }
-                    }
-                }
             }
-            else if (com == '\n') {
-                /* Ignore blank input */
+
+            code = run_command(com, from, to, loc1, loc2);
+
+            if (com == 'p' && deck.size < before) {
+                printf("moved!");
             }
         }
     }
 
     return 0;
 }
+
+#endif
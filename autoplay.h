@@ -0,0 +1,222 @@
+#ifndef AUTOPLAY_H
+#define AUTOPLAY_H
+
+#include "solitaire.h"
+
+// Plays cards to the final piles once nothing left in the game could want
+// to build on them, and plays out the rest once the game is won outright.
+//
+// Rather than rescanning the piles after every move, it keeps the height of
+// each suit on the final piles and a worklist of cards that may have become
+// playable: the new tops of piles a move touched, and the cards a new final
+// card unblocks. Cards are found, and a won game spotted, through the
+// game's move index.
+class autoplay
+{
+public:
+    autoplay() = default;
+
+    autoplay(const autoplay &other)
+    {
+        *this = other;
+    }
+
+    // Copies only the live part of the worklist, which is usually empty
+    autoplay &operator=(const autoplay &other)
+    {
+        for (int s = 0; s < 4; s++)
+        {
+            home[s] = other.home[s];
+            height[s] = other.height[s];
+        }
+        pending = other.pending;
+        for (int i = 0; i < pending; i++)
+        {
+            worklist[i] = other.worklist[i];
+        }
+        return *this;
+    }
+
+    // Rebuild the bookkeeping, e.g. after a deal
+    void reset(const game &g)
+    {
+        for (int s = 0; s < 4; s++)
+        {
+            home[s] = -1;
+            height[s] = 0;
+        }
+
+        for (int t = 0; t < 4; t++)
+        {
+            if (g.final[t].size() > 0)
+            {
+                int s = get_suit(g.final[t].back().value);
+                home[s] = t;
+                height[s] = g.final[t].size();
+            }
+        }
+
+        pending = 0;
+        for (int x = 0; x < 6; x++)
+        {
+            push_top(g.stacks[x]);
+        }
+        push_top(g.deck);
+    }
+
+    // Take note of a command the player has just applied
+    void note(const game &g, const command &c)
+    {
+        if ((c.com == 'P' || c.com == 'Q') && valid_final(c.to) && g.final[c.to].size() > 0)
+        {
+            int value = g.final[c.to].back().value;
+            int s = get_suit(value);
+            if (height[s] != get_num(value))
+            {
+                home[s] = c.to;
+                height[s] = get_num(value);
+                push_unblocked(value);
+            }
+        }
+
+        if (valid_stack(c.from))
+        {
+            push_top(g.stacks[c.from]);
+        }
+        if (valid_stack(c.to))
+        {
+            push_top(g.stacks[c.to]);
+        }
+        push_top(g.deck);
+    }
+
+    // Play every safe card, then the whole game if it is won. Returns the
+    // number of cards played.
+    int run(game &g)
+    {
+        int played = 0;
+
+        while (pending > 0)
+        {
+            int value = worklist[--pending];
+            if (playable(value) && safe(value) && play(g, value))
+            {
+                played++;
+            }
+        }
+
+        if (solved(g))
+        {
+            // The lowest card left is always on top of its stack
+            uint64_t ready;
+            while ((ready = g.index.tops & g.index.next_home) != 0 && play(g, __builtin_ctzll(ready)))
+            {
+                played++;
+            }
+        }
+
+        return played;
+    }
+
+    // Nothing can build on value: both cards that could go on it are home
+    bool safe(int value) const
+    {
+        int r = get_num(value);
+        int s = get_suit(value);
+        return r <= 2 || (height[(s + 1) % 4] >= r - 1 && height[(s + 3) % 4] >= r - 1);
+    }
+
+    // The deck is empty and every stack is face up with its values falling
+    // towards the top, so the final piles can take everything in order
+    static bool solved(const game &g)
+    {
+        return g.deck.size() == 0 && g.index.unsorted == 0;
+    }
+
+private:
+    bool playable(int value) const
+    {
+        return height[get_suit(value)] == get_num(value) - 1;
+    }
+
+    // Move value to its final pile if it is on top of a stack or the deck
+    bool play(game &g, int value)
+    {
+        int s = get_suit(value);
+        int to = home[s];
+
+        if (to < 0)
+        {
+            for (int t = 3; t >= 0; t--)
+            {
+                if (g.final[t].size() == 0)
+                {
+                    to = t;
+                }
+            }
+        }
+
+        command c = {0, 0, to, 0, 0};
+
+        if (g.deck.size() > 0 && g.deck.back().value == value)
+        {
+            c.com = 'Q';
+        }
+        else if (g.index.tops >> value & 1)
+        {
+            c.com = 'P';
+            c.from = g.index.where[value] - 1;
+        }
+
+        if (c.com == 0 || to < 0)
+        {
+            return false;
+        }
+
+        apply_command(g, c);
+        home[s] = to;
+        height[s] = get_num(value);
+
+        push_top(c.com == 'Q' ? g.deck : g.stacks[c.from]);
+        push_unblocked(value);
+        return true;
+    }
+
+    void push(int value)
+    {
+        if (pending < (int)(sizeof(worklist) / sizeof(worklist[0])))
+        {
+            worklist[pending++] = value;
+        }
+    }
+
+    void push_top(const pile &p)
+    {
+        if (p.size() > 0)
+        {
+            push(p.back().value);
+        }
+    }
+
+    // value just went home: the next card of its suit may be playable, and
+    // the next cards of the other colour may now be safe
+    void push_unblocked(int value)
+    {
+        int s = get_suit(value);
+        int r = get_num(value);
+
+        if (r < 13)
+        {
+            push(value + 1);
+            push(((s + 1) % 4) * 13 + r);
+            push(((s + 3) % 4) * 13 + r);
+        }
+    }
+
+    int home[4];
+    int height[4];
+    int worklist[4 * COUNT];
+    int pending = 0;
+};
+
+#endif
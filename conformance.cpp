@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "solitaire.h"
+#include "autoplay.h"
+
+using namespace std;
+
+// The C engine, from ansi-solitaire.c built with -DANSI_SOLITAIRE_LIBRARY.
+// Piles are numbered 0 for the deck, 1..6 for the stacks, 7..10 for finals.
+extern "C"
+{
+    int run_command(char com, int from, int to, int loc1, int loc2);
+    int get_pile(int n, int *values, int *visible);
+    void set_pile(int n, const int *values, const int *visible, int size);
+}
+
+const pile &cpp_pile(const game &g, int n)
+{
+    if (n == 0)
+    {
+        return g.deck;
+    }
+    if (n <= 6)
+    {
+        return g.stacks[n - 1];
+    }
+    return g.final[n - 7];
+}
+
+// Copy the C++ game into the C engine
+void load(const game &g)
+{
+    int values[COUNT], visible[COUNT];
+
+    for (int n = 0; n < 11; n++)
+    {
+        const pile &p = cpp_pile(g, n);
+        for (int i = 0; i < (int)p.size(); i++)
+        {
+            values[i] = p[i].value;
+            visible[i] = p[i].visible;
+        }
+        set_pile(n, values, visible, p.size());
+    }
+}
+
+// Index of the first pile that differs, or -1 when both engines agree
+int compare(const game &g)
+{
+    int values[COUNT], visible[COUNT];
+
+    for (int n = 0; n < 11; n++)
+    {
+        const pile &p = cpp_pile(g, n);
+        int size = get_pile(n, values, visible);
+
+        if (size != (int)p.size())
+        {
+            return n;
+        }
+
+        for (int i = 0; i < size; i++)
+        {
+            if (values[i] != p[i].value || (visible[i] != 0) != p[i].visible)
+            {
+                return n;
+            }
+        }
+    }
+
+    return -1;
+}
+
+void print_pile(const char *engine, int n, const int *values, const int *visible, int size)
+{
+    printf("  %s pile %2i:", engine, n);
+    for (int i = 0; i < size; i++)
+    {
+        printf(" %s", display_card({values[i], visible[i] != 0}).text);
+    }
+    printf("\n");
+}
+
+void report(const game &g, int n)
+{
+    int values[COUNT], visible[COUNT];
+
+    const pile &p = cpp_pile(g, n);
+    for (int i = 0; i < (int)p.size(); i++)
+    {
+        values[i] = p[i].value;
+        visible[i] = p[i].visible;
+    }
+    print_pile("C++", n, values, visible, p.size());
+
+    int size = get_pile(n, values, visible);
+    print_pile("C  ", n, values, visible, size);
+}
+
+bool operator<(const command &a, const command &b)
+{
+    return tie(a.com, a.from, a.to, a.loc1, a.loc2) < tie(b.com, b.from, b.to, b.loc1, b.loc2);
+}
+
+bool operator==(const command &a, const command &b)
+{
+    return tie(a.com, a.from, a.to, a.loc1, a.loc2) == tie(b.com, b.from, b.to, b.loc1, b.loc2);
+}
+
+void print_moves(const char *name, const vector<command> &moves)
+{
+    printf("  %s:", name);
+    for (const command &c : moves)
+    {
+        printf(" %c%i%i%i%i", c.com, c.from, c.to, c.loc1, c.loc2);
+    }
+    printf("\n");
+}
+
+// A random command. Indices run one past each end so the bounds handling
+// of both engines is exercised too.
+command random_command(const game &g, minstd_rand &rng)
+{
+    static const char coms[] = {'m', 'M', 'n', 'p', 'P', 'Q', 'x'};
+
+    command c = {coms[rng() % sizeof(coms)], 0, 0, 0, 0};
+    c.from = (int)(rng() % 8) - 1;
+    c.to = (int)(rng() % 8) - 1;
+
+    if (c.com == 'M' && valid_stack(c.from) && valid_stack(c.to))
+    {
+        c.loc1 = (int)(rng() % (g.stacks[c.from].size() + 2)) - 1;
+        c.loc2 = (int)(rng() % (g.stacks[c.to].size() + 2)) - 1;
+    }
+
+    return c;
+}
+
+// Play games of random legal moves with autoplay after each one, and check
+// it against a rescan: no safe card may be left playable, the index must
+// know which stacks are sorted, and a game that can be played out must be
+// won. Returns false at the first miss.
+bool check_autoplay(int games, unsigned seed)
+{
+    vector<command> moves;
+
+    for (int d = 0; d < games; d++)
+    {
+        minstd_rand rng(seed + d);
+        game g;
+
+        // Random play seldom empties the deck, so first lay the pack out
+        // face up with every stack falling: autoplay must win it at once
+        for (int r = 13; r >= 1; r--)
+        {
+            int order[6] = {0, 1, 2, 3, 4, 5};
+            shuffle(order, order + 6, rng);
+            for (int s = 0; s < 4; s++)
+            {
+                g.stacks[order[s]].push_back({s * 13 + r - 1, true});
+            }
+        }
+        g.index.rebuild(g);
+
+        autoplay engine;
+        engine.reset(g);
+        if (!autoplay::solved(g) || (engine.run(g), !won(g)))
+        {
+            printf("autoplay did not play out a sorted layout (seed %u)\n", seed + d);
+            return false;
+        }
+
+        deal(g, [&rng] { return (int)(rng() >> 1); });
+
+        engine.reset(g);
+        engine.run(g);
+
+        for (int m = 0; m < 2000 && !won(g); m++)
+        {
+            legal_moves(g, moves);
+            if (moves.size() == 0)
+            {
+                break;
+            }
+
+            command c = moves[rng() % moves.size()];
+            apply_command(g, c);
+            engine.note(g, c);
+            engine.run(g);
+
+            int height[4] = {0, 0, 0, 0};
+            for (int t = 0; t < 4; t++)
+            {
+                if (g.final[t].size() > 0)
+                {
+                    height[get_suit(g.final[t].back().value)] = g.final[t].size();
+                }
+            }
+
+            bool sorted = true;
+            for (int x = 0; x < 7; x++)
+            {
+                const pile &p = x < 6 ? g.stacks[x] : g.deck;
+                if (p.size() > 0 && height[get_suit(p.back().value)] == get_num(p.back().value) - 1 &&
+                    engine.safe(p.back().value))
+                {
+                    printf("autoplay left %s on pile %i (deal %u, move %i)\n", display_card(p.back()).text,
+                           x, seed + d, m);
+                    return false;
+                }
+
+                for (int i = 0; x < 6 && i < (int)p.size(); i++)
+                {
+                    if (!p[i].visible || (i > 0 && get_num(p[i].value) >= get_num(p[i - 1].value)))
+                    {
+                        sorted = false;
+                    }
+                }
+            }
+
+            if (sorted != (g.index.unsorted == 0))
+            {
+                printf("move index disagrees on sorted stacks (deal %u, move %i)\n", seed + d, m);
+                return false;
+            }
+            if (sorted && g.deck.size() == 0 && !won(g))
+            {
+                printf("autoplay did not play out a sorted game (deal %u, move %i)\n", seed + d, m);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Play steps random steps on both engines, checking the move index every
+// index_every steps (never if 0). Returns false, after printing how it got
+// there, at the first divergence.
+bool run(long steps, int game_length, unsigned seed, int index_every)
+{
+    minstd_rand rng(seed);
+    game g;
+    vector<command> history;
+    vector<command> moves, indexed, scanned;
+    unsigned deal_seed = 0;
+
+    for (long step = 0; step < steps; step++)
+    {
+        if (step % game_length == 0)
+        {
+            deal_seed = rng();
+            minstd_rand deal_rng(deal_seed);
+            deal(g, [&deal_rng] { return (int)(deal_rng() >> 1); });
+            load(g);
+            history.clear();
+        }
+
+        // Half the commands are legal moves so games actually progress
+        command c;
+        if (rng() % 2 == 0)
+        {
+            legal_moves(g, moves);
+            c = moves.size() > 0 ? moves[rng() % moves.size()] : random_command(g, rng);
+        }
+        else
+        {
+            c = random_command(g, rng);
+        }
+        history.push_back(c);
+
+        int cpp_code = apply_command(g, c);
+        int c_code = run_command(c.com, c.from, c.to, c.loc1, c.loc2);
+        int differs = compare(g);
+
+        // The move index must agree with a scan of every pile. The scan
+        // costs more than the rest of the step, so it is only run now and
+        // then.
+        bool index_ok = true;
+        if (index_every > 0 && step % index_every == 0)
+        {
+            legal_moves(g, indexed);
+            scan_moves(g, scanned);
+            sort(indexed.begin(), indexed.end());
+            sort(scanned.begin(), scanned.end());
+            index_ok = indexed == scanned;
+        }
+
+        if (differs >= 0 || cpp_code != c_code || !index_ok)
+        {
+            printf("Engines diverge at step %li of seed %u (deal seed %u, move %zu)\n", step, seed, deal_seed,
+                   history.size());
+            for (const command &h : history)
+            {
+                printf("  %c %i %i %i %i\n", h.com, h.from, h.to, h.loc1, h.loc2);
+            }
+            printf("code: C++ %i, C %i\n", cpp_code, c_code);
+            if (!index_ok)
+            {
+                printf("move index disagrees with a scan\n");
+                print_moves("index", indexed);
+                print_moves("scan ", scanned);
+            }
+            if (differs >= 0)
+            {
+                report(g, differs);
+            }
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    long steps = argc > 1 ? atol(argv[1]) : 10000000;
+    int game_length = argc > 2 ? atoi(argv[2]) : 500;
+    unsigned seed = argc > 3 ? atoi(argv[3]) : 1;
+    int workers = argc > 4 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int index_every = argc > 5 ? atoi(argv[5]) : 16;
+
+    if (workers < 1)
+    {
+        workers = 1;
+    }
+
+    if (!check_autoplay(3000, seed))
+    {
+        return 1;
+    }
+    printf("autoplay agrees with a rescan over 3000 games\n");
+
+    auto start = chrono::steady_clock::now();
+
+    // The C engine keeps its state in globals, so each worker is a process
+    // of its own, running its share of the steps from seed + worker
+    fflush(stdout);
+    for (int w = 0; w < workers; w++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("fork");
+            return 1;
+        }
+        if (pid == 0)
+        {
+            long share = steps / workers + (w < steps % workers ? 1 : 0);
+            bool ok = run(share, game_length, seed + w, index_every);
+            fflush(stdout);
+            _exit(ok ? 0 : 1);
+        }
+    }
+
+    bool ok = true;
+    int status;
+    while (wait(&status) > 0)
+    {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ok = false;
+        }
+    }
+
+    if (!ok)
+    {
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%li steps agree, %.0f steps/sec on %i workers\n", steps, seconds > 0 ? steps / seconds : 0.0, workers);
+
+    return 0;
+}
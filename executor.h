@@ -0,0 +1,171 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <poll.h>
+#include <unistd.h>
+#include <coroutine>
+#include <deque>
+#include <exception>
+
+// A coroutine that the executor runs to completion; nobody awaits it
+struct task
+{
+    struct promise_type
+    {
+        task get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Single-threaded scheduler. Foreground tasks (input, drawing) always run
+// before the next background slice, and stdin is polled between slices so
+// a keypress is picked up within one slice of arriving.
+class executor
+{
+public:
+    void spawn(task t, bool background = false)
+    {
+        schedule(t.handle, background);
+    }
+
+    void schedule(std::coroutine_handle<> h, bool background = false)
+    {
+        (background ? idle : ready).push_back(h);
+    }
+
+    // co_await loop.yield() lets foreground work and input in
+    auto yield()
+    {
+        struct awaiter
+        {
+            executor &e;
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h) { e.idle.push_back(h); }
+            void await_resume() {}
+        };
+        return awaiter{*this};
+    }
+
+    // co_await loop.readable() resumes once stdin has data or is closed
+    auto readable()
+    {
+        struct awaiter
+        {
+            executor &e;
+            bool await_ready() { return false; }
+            void await_suspend(std::coroutine_handle<> h) { e.reader = h; }
+            void await_resume() {}
+        };
+        return awaiter{*this};
+    }
+
+    // run() returns once the foreground work already queued is done
+    void stop()
+    {
+        stopped = true;
+    }
+
+    void run()
+    {
+        while (true)
+        {
+            if (ready.size() > 0)
+            {
+                std::coroutine_handle<> h = ready.front();
+                ready.pop_front();
+                h.resume();
+                continue;
+            }
+
+            if (stopped)
+            {
+                break;
+            }
+
+            if (reader)
+            {
+                // Block only when there is nothing else to do
+                pollfd p = {STDIN_FILENO, POLLIN, 0};
+                if (poll(&p, 1, idle.size() > 0 ? 0 : -1) > 0)
+                {
+                    std::coroutine_handle<> h = reader;
+                    reader = nullptr;
+                    ready.push_back(h);
+                    continue;
+                }
+            }
+
+            if (idle.size() > 0)
+            {
+                std::coroutine_handle<> h = idle.front();
+                idle.pop_front();
+                h.resume();
+                continue;
+            }
+
+            if (!reader)
+            {
+                // Every task is waiting on an event nobody can set
+                break;
+            }
+        }
+    }
+
+private:
+    std::deque<std::coroutine_handle<>> ready;
+    std::deque<std::coroutine_handle<>> idle;
+    std::coroutine_handle<> reader;
+    bool stopped = false;
+};
+
+// A flag one task waits on and others set. Setting it while the waiter is
+// busy is remembered, so the waiter never misses a change.
+class event
+{
+public:
+    explicit event(executor &e, bool background = false) : e(e), background(background) {}
+
+    void set()
+    {
+        if (waiter)
+        {
+            std::coroutine_handle<> h = waiter;
+            waiter = nullptr;
+            e.schedule(h, background);
+        }
+        else
+        {
+            pending = true;
+        }
+    }
+
+    auto operator co_await()
+    {
+        struct awaiter
+        {
+            event &ev;
+            bool await_ready()
+            {
+                bool was = ev.pending;
+                ev.pending = false;
+                return was;
+            }
+            void await_suspend(std::coroutine_handle<> h) { ev.waiter = h; }
+            void await_resume() {}
+        };
+        return awaiter{*this};
+    }
+
+private:
+    executor &e;
+    bool background;
+    bool pending = false;
+    std::coroutine_handle<> waiter;
+};
+
+#endif
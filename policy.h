@@ -0,0 +1,158 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "solitaire.h"
+
+// What a policy may look at: the stacks, the top of the deck and the
+// final piles. Cards that are not visible come back with value -1.
+class game_view
+{
+public:
+    explicit game_view(const game &g) : g(g) {}
+
+    int stack_size(int i) const { return g.stacks[i].size(); }
+    card stack_card(int i, int n) const { return seen(g.stacks[i][n]); }
+    const pile &final(int i) const { return g.final[i]; }
+    int deck_size() const { return g.deck.size(); }
+
+    // The top of the deck; value -1 if the deck is empty
+    card deck_top() const { return g.deck.size() > 0 ? seen(g.deck.back()) : card{-1, false}; }
+
+    // Commands that apply_command() would carry out on face-up cards
+    void moves(std::vector<command> &out) const { legal_moves(g, out); }
+
+private:
+    static card seen(const card &c)
+    {
+        return c.visible ? c : card{-1, false};
+    }
+
+    const game &g;
+};
+
+// An automated player. Instances are not shared between threads, so a
+// policy may keep whatever state it likes.
+class policy
+{
+public:
+    virtual ~policy() {}
+
+    // Called before each deal with a seed fixed by the deal, so results do
+    // not depend on which thread played which deals
+    virtual void new_game(unsigned seed) = 0;
+
+    // Pick the next command; returning 0 in com resigns the game
+    virtual command choose(const game_view &v) = 0;
+};
+
+// Builds one policy instance per thread
+struct policy_entry
+{
+    std::string name;
+    std::unique_ptr<policy> (*make)(unsigned seed);
+};
+
+// Picks uniformly among the legal moves
+class random_policy : public policy
+{
+public:
+    explicit random_policy(unsigned seed) : rng(seed) {}
+
+    void new_game(unsigned seed) override
+    {
+        rng.seed(seed);
+    }
+
+    command choose(const game_view &v) override
+    {
+        v.moves(moves);
+        if (moves.size() == 0)
+        {
+            return {0, 0, 0, 0, 0};
+        }
+
+        return moves[rng() % moves.size()];
+    }
+
+private:
+    std::minstd_rand rng;
+    std::vector<command> moves;
+};
+
+// Plays to the final piles first, then moves that turn up a hidden card,
+// then the deck, and only then rearranges the stacks
+class greedy_policy : public policy
+{
+public:
+    explicit greedy_policy(unsigned seed) : rng(seed) {}
+
+    void new_game(unsigned seed) override
+    {
+        rng.seed(seed);
+    }
+
+    command choose(const game_view &v) override
+    {
+        v.moves(moves);
+
+        command best = {0, 0, 0, 0, 0};
+        int best_score = -1;
+
+        for (const command &c : moves)
+        {
+            int score = 0;
+
+            if (c.com == 'P' || c.com == 'Q')
+            {
+                score = 4;
+            }
+            else if ((c.com == 'm' || c.com == 'M') && uncovers(v, c))
+            {
+                score = 3;
+            }
+            else if (c.com == 'p')
+            {
+                score = 2;
+            }
+            else if (c.com == 'n')
+            {
+                score = 1;
+            }
+
+            // Break ties at random so the stock keeps turning over
+            if (score > best_score || (score == best_score && rng() % 2 == 0))
+            {
+                best = c;
+                best_score = score;
+            }
+        }
+
+        return best;
+    }
+
+private:
+    static bool uncovers(const game_view &v, const command &c)
+    {
+        int below = (c.com == 'm' ? v.stack_size(c.from) - 1 : c.loc1) - 1;
+        return below >= 0 && !v.stack_card(c.from, below).visible;
+    }
+
+    std::minstd_rand rng;
+    std::vector<command> moves;
+};
+
+inline const std::vector<policy_entry> &builtin_policies()
+{
+    static const std::vector<policy_entry> entries = {
+        {"random", [](unsigned seed) -> std::unique_ptr<policy> { return std::make_unique<random_policy>(seed); }},
+        {"greedy", [](unsigned seed) -> std::unique_ptr<policy> { return std::make_unique<greedy_policy>(seed); }},
+    };
+    return entries;
+}
+
+#endif
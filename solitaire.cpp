@@ -1,64 +1,46 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
 #include <iostream>
-#include <vector>
 #include <string>
-#include <random>
+#include <vector>
+
+#include "solitaire.h"
+#include "autoplay.h"
+#include "executor.h"
 
 using namespace std;
 
-constexpr int COUNT = 52;
 constexpr int SCREEN_SIZE = 16;
 
-struct card
-{
-    int value;
-    bool visible;
-};
-
-vector<card> deck;
-vector<card> stacks[6];
-vector<card> final[4];
-
-int get_suit(int t)
-{
-    return t / 13;
-}
-
-int get_num(int t)
-{
-    return (t % 13) + 1;
-}
-
-// Display card value
-string display_card(card c)
-{
-    if (c.visible)
-    {
-        int t = c.value;
+game state;
 
-        char buffer[16];
-        snprintf(buffer, sizeof(buffer), "%i:%2d", get_suit(t), get_num(t));
-        string result = buffer;
-        return result;
-    }
+executor loop;
+event moved(loop);
+event dirty(loop);
+event changed(loop, true);
 
-    return "X:XX";
-}
+int code = 0;
+command last = {0, 0, 0, 0, 0};
 
-string check_card(vector<card> &stack, int i)
+card_text check_card(pile &stack, int i)
 {
     if (i < stack.size())
     {
-        if (i == stack.size() - 1)
+        if (i == stack.size() - 1 && !stack.at(i).visible)
         {
             stack.at(i).visible = true;
+            state.index.refresh(state, stack.at(i).value);
         }
 
         return display_card(stack.at(i));
     }
     else
     {
-        return "    ";
+        return {"    "};
     }
 }
 
@@ -68,9 +50,9 @@ void display()
     cout << "0      1      2      3      " << endl;
     for (int t = 0; t < 4; t++)
     {
-        if (final[t].size() > 0)
+        if (state.final[t].size() > 0)
         {
-            cout << "[" << display_card(final[t].back()) << "] ";
+            cout << "[" << display_card(state.final[t].back()).text << "] ";
         }
         else
         {
@@ -78,22 +60,30 @@ void display()
         }
     }
 
-    deck.back().visible = true;
-    cout << "/ " << display_card(deck.back()) << endl
-         << endl;
+    if (state.deck.size() > 0)
+    {
+        state.deck.back().visible = true;
+        cout << "/ " << display_card(state.deck.back()).text << endl
+             << endl;
+    }
+    else
+    {
+        cout << "/ [    ]" << endl
+             << endl;
+    }
     cout << "0     1     2     3     4     5" << endl;
 
     for (int y = 0; y < 6; y++)
     {
-        for (int x = 0; x < 11; x++)
+        for (int x = 0; x < 6; x++)
         {
             int offset = 0;
-            if (stacks[x].size() > 6)
+            if (state.stacks[x].size() > 6)
             {
-                offset = stacks[x].size() - 6;
+                offset = state.stacks[x].size() - 6;
             }
 
-            cout << check_card(stacks[x], y + offset) << "  ";
+            cout << check_card(state.stacks[x], y + offset).text << "  ";
         }
         cout << endl;
     }
@@ -119,218 +109,518 @@ void display_code(int c)
     }
 }
 
-int main()
+void display_stack(pile &stack)
 {
-    // Initial deck
-    for (int t = 0; t < COUNT; t++)
+    for (int t = 0; t < stack.size(); t++)
     {
-        card c = {t, false};
-        deck.push_back(c);
+        cout << t << "    ";
     }
-
-    // Shuffle
-    for (int t = 0; t < COUNT; t++)
+    cout << endl;
+    for (int t = 0; t < stack.size(); t++)
     {
-        int move = rand() % COUNT;
-        card c = deck.at(move);
-        deck.erase(deck.begin() + move);
-        deck.push_back(c);
+        cout << display_card(stack.at(t)).text << " ";
     }
+    cout << endl;
+}
 
-    for (int x = 0; x < 6; x++)
+// Input latency, from the moment a line was sent to the answer being
+// flushed. With -l each line starts with @ and the sender's clock in
+// nanoseconds since the epoch, so time spent queued behind the hint search
+// counts too.
+bool measure = false;
+bool analysing = false;
+bool input_pending = false;
+bool input_while_analysing = false;
+chrono::system_clock::time_point input_time;
+vector<double> idle_latency, busy_latency;
+double longest_slice = 0;
+
+// -b keeps the hint search running, starting it over each time it ends, so
+// there is always background work for input to wait behind
+bool load = false;
+
+// When the current hint search started, and when the last one ran
+chrono::system_clock::time_point search_start, last_start, last_end;
+
+// The hint search was running at time t
+bool searching_at(chrono::system_clock::time_point t)
+{
+    return (analysing && t >= search_start) || (t >= last_start && t <= last_end);
+}
+
+struct stamp
+{
+    chrono::system_clock::time_point sent;
+    bool analysing; // the hint search was running when the line was sent
+};
+
+// Words typed so far, split on whitespace, for the input task. A send
+// time is kept as the word "@", with the time itself in stamps.
+deque<string> words;
+deque<stamp> stamps;
+bool input_closed = false;
+coroutine_handle<> word_waiter;
+
+// co_await next_word() gives the next word typed, or "" once input ends
+struct next_word
+{
+    bool await_ready() { return words.size() > stamps.size() || input_closed; }
+    void await_suspend(coroutine_handle<> h) { word_waiter = h; }
+
+    string await_resume()
     {
-        for (int t = 0; t < x + 1; t++)
+        while (words.size() > 0 && words.front() == "@")
         {
-            stacks[x].push_back(deck.back());
-            deck.pop_back();
+            words.pop_front();
+            if (!input_pending)
+            {
+                input_pending = true;
+                input_time = stamps.front().sent;
+                input_while_analysing = stamps.front().analysing;
+            }
+            stamps.pop_front();
         }
+
+        if (words.size() == 0)
+        {
+            return "";
+        }
+
+        string w = words.front();
+        words.pop_front();
+        return w;
     }
+};
 
-    int code = 0;
+int number(const string &w)
+{
+    return strtol(w.c_str(), nullptr, 0);
+}
 
-    while (true)
+void respond()
+{
+    fflush(stdout);
+
+    if (input_pending)
     {
-        for (int t = 0; t < SCREEN_SIZE; t++)
-        {
-            cout << endl;
-        }
+        double ms = chrono::duration<double, milli>(chrono::system_clock::now() - input_time).count();
+        (input_while_analysing ? busy_latency : idle_latency).push_back(ms);
+        input_pending = false;
+    }
+}
 
-        display_code(code);
-        code = 0;
+void report_latency(const char *name, vector<double> &samples)
+{
+    if (samples.size() == 0)
+    {
+        fprintf(stderr, "%-16s no samples\n", name);
+        return;
+    }
 
-        display();
-        char com;
-        int from, to;
-        printf("?");
-        scanf("%c", &com);
+    sort(samples.begin(), samples.end());
 
-        if (com == 'm')
-        {
-            printf(">>");
-            scanf(" %i %i", &from, &to);
+    double sum = 0;
+    for (double ms : samples)
+    {
+        sum += ms;
+    }
 
-            int c1 = stacks[from].back().value;
-            int c2 = stacks[to].back().value;
+    fprintf(stderr, "%-16s n=%-5zu mean %.3f  p50 %.3f  p99 %.3f  max %.3f ms\n", name, samples.size(),
+            sum / samples.size(), samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back());
+}
+
+// Best first move found so far for the current position
+constexpr int HINT_DEPTH = 24;
+command hint = {0, 0, 0, 0, 0};
+int hint_depth = 0;
+bool show_hint = false;
+long generation = 0;
+
+void add_word(const string &w)
+{
+    if (measure && w[0] == '@')
+    {
+        long long ns = strtoll(w.c_str() + 1, nullptr, 10);
+        chrono::system_clock::time_point sent{chrono::nanoseconds(ns)};
+        stamps.push_back({sent, searching_at(sent)});
+        words.push_back("@");
+        return;
+    }
+    words.push_back(w);
+}
+
+task read_input()
+{
+    char buffer[256];
+    string partial;
+
+    while (true)
+    {
+        co_await loop.readable();
 
-            if ((get_suit(c1) + 1) % 2 == get_suit(c2) % 2)
+        ssize_t n = read(STDIN_FILENO, buffer, sizeof(buffer));
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (isspace((unsigned char)buffer[i]))
             {
-                if (get_num(c2) - get_num(c1) == 1)
-                {
-                    stacks[from].pop_back();
-                    stacks[to].push_back({c1, true});
-                }
-                else
+                if (partial.size() > 0)
                 {
-                    code = 1;
+                    add_word(partial);
+                    partial.clear();
                 }
             }
             else
             {
-                code = 2;
+                partial += buffer[i];
             }
         }
-        else if (com == 'M')
+
+        if (n <= 0)
         {
-            printf(">>");
-            scanf(" %i %i", &from, &to);
+            if (partial.size() > 0)
+            {
+                add_word(partial);
+            }
+            input_closed = true;
+        }
 
-            cout << endl;
+        if (word_waiter && (words.size() > stamps.size() || input_closed))
+        {
+            loop.schedule(word_waiter);
+            word_waiter = nullptr;
+        }
 
-            for (int t = 0; t < stacks[from].size(); t++)
+        if (input_closed)
+        {
+            co_return;
+        }
+    }
+}
+
+task play_input()
+{
+    while (true)
+    {
+        string w = co_await next_word();
+        if (w.size() == 0)
+        {
+            break;
+        }
+
+        // Input that ends part way through a command runs nothing, as in
+        // ansi-solitaire.c
+        command c = {w[0], 0, 0, 0, 0};
+        string arg;
+
+        if (c.com == 'm' || c.com == 'P')
+        {
+            printf(">>");
+            respond();
+            if ((arg = co_await next_word()).size() == 0)
             {
-                cout << t << "    ";
+                break;
             }
-            cout << endl;
-            for (int t = 0; t < stacks[from].size(); t++)
+            c.from = number(arg);
+            if ((arg = co_await next_word()).size() == 0)
             {
-                cout << display_card(stacks[from].at(t)) << " ";
+                break;
             }
-            cout << endl;
-
-            for (int t = 0; t < stacks[to].size(); t++)
+            c.to = number(arg);
+        }
+        else if (c.com == 'M')
+        {
+            printf(">>");
+            respond();
+            if ((arg = co_await next_word()).size() == 0)
             {
-                cout << t << "    ";
+                break;
             }
-            cout << endl;
-            for (int t = 0; t < stacks[to].size(); t++)
+            c.from = number(arg);
+            if ((arg = co_await next_word()).size() == 0)
             {
-                cout << display_card(stacks[to].at(t)) << " ";
+                break;
             }
-            cout << endl;
+            c.to = number(arg);
 
-            int loc1, loc2;
-            printf(">>");
-            scanf(" %i %i", &loc1, &loc2);
+            cout << endl;
 
-            int c1 = stacks[from].at(loc1).value;
-            int c2 = stacks[to].at(loc2).value;
+            if (valid_stack(c.from) && valid_stack(c.to))
+            {
+                display_stack(state.stacks[c.from]);
+                display_stack(state.stacks[c.to]);
+            }
 
-            if ((get_suit(c1) + 1) % 2 == get_suit(c2) % 2)
+            printf(">>");
+            respond();
+            if ((arg = co_await next_word()).size() == 0)
             {
-                if (get_num(c2) - get_num(c1) == 1)
-                {
-                    int count = stacks[from].size() - loc1;
-                    while (stacks[from].size() > loc1)
-                    {
-                        card f = stacks[from].at(loc1);
-                        stacks[to].insert(stacks[to].begin() + loc2, f);
-                        stacks[from].erase(stacks[from].begin() + loc1);
-                    }
-                }
+                break;
             }
+            c.loc1 = number(arg);
+            if ((arg = co_await next_word()).size() == 0)
+            {
+                break;
+            }
+            c.loc2 = number(arg);
+        }
+        else if (c.com == 'p' || c.com == 'Q')
+        {
+            printf(">");
+            respond();
+            if ((arg = co_await next_word()).size() == 0)
+            {
+                break;
+            }
+            c.to = number(arg);
         }
+        else if (c.com == 'h')
+        {
+            show_hint = true;
+            dirty.set();
+            continue;
+        }
+
+        size_t before = state.deck.size();
+        code = apply_command(state, c);
 
-        else if (com == 'n')
+        if (c.com == 'p' && state.deck.size() < before)
         {
-            card v = deck.back();
-            deck.pop_back();
-            deck.insert(deck.begin(), v);
+            printf("moved!");
         }
-        else if (com == 'p')
+
+        last = c;
+        moved.set();
+    }
+
+    loop.stop();
+}
+
+task render()
+{
+    while (true)
+    {
+        co_await dirty;
+
+        for (int t = 0; t < SCREEN_SIZE; t++)
         {
-            printf(">");
-            scanf(" %i", &to);
-            int c1 = (deck.back().value);
-            int c2 = (stacks[to].back().value);
+            cout << endl;
+        }
 
-            if ((get_suit(c1) + 1) % 2 == get_suit(c2) % 2)
+        display_code(code);
+        code = 0;
+
+        display();
+
+        if (show_hint)
+        {
+            if (hint_depth == 0)
             {
-                if (get_num(c2) - get_num(c1) == 1)
+                printf("thinking...\n");
+            }
+            else
+            {
+                printf("hint: %c", hint.com);
+                if (hint.com == 'm' || hint.com == 'P' || hint.com == 'M')
                 {
-                    deck.pop_back();
-                    stacks[to].push_back({c1, true});
-                    printf("moved!");
+                    printf(" %i %i", hint.from, hint.to);
                 }
-                else
+                if (hint.com == 'p' || hint.com == 'Q')
                 {
-                    code = 4;
+                    printf(" %i", hint.to);
                 }
+                if (hint.com == 'M')
+                {
+                    printf(" %i %i", hint.loc1, hint.loc2);
+                }
+                printf("\n");
             }
-            else
-            {
-                code = 3;
-            }
+            show_hint = false;
         }
-        else if (com == 'P')
+
+        printf("?");
+        respond();
+    }
+}
+
+// Plays every safe card to the final piles after each move, so the screen
+// is redrawn once rather than once per card
+task play_safe()
+{
+    autoplay engine;
+    engine.reset(state);
+
+    while (true)
+    {
+        co_await moved;
+
+        engine.note(state, last);
+        engine.run(state);
+
+        generation++;
+        changed.set();
+        dirty.set();
+    }
+}
+
+int hidden(const game &g)
+{
+    int count = 0;
+    for (int x = 0; x < 6; x++)
+    {
+        for (const card &c : g.stacks[x])
         {
-            printf(">>");
-            scanf(" %i %i", &from, &to);
+            count += !c.visible;
+        }
+    }
+    return count;
+}
 
-            int c1 = stacks[from].back().value;
+int score(const game &g)
+{
+    int count = 0;
+    for (int t = 0; t < 4; t++)
+    {
+        count += g.final[t].size();
+    }
+    return 4 * count - hidden(g);
+}
 
-            if (final[to].size() == 0)
-            {
-                if (get_num(c1) == 1)
-                {
-                    card c = stacks[from].back();
-                    final[to].push_back(c);
-                    stacks[from].pop_back();
-                }
-            }
-            else
-            {
-                int c2 = final[to].back().value;
+double since(chrono::steady_clock::time_point t)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t).count();
+}
 
-                if (get_num(c1) == get_num(c2) + 1 && get_suit(c1) == get_suit(c2))
-                {
-                    card c = stacks[from].back();
-                    final[to].push_back(c);
-                    stacks[from].pop_back();
-                }
-            }
+// Searches a few moves ahead in the background for the best next move,
+// deepening one move at a time and starting over whenever the game changes.
+// A move that turns up a card the player may not have seen ends its line:
+// a face-down stack card, or a new deck top after n, p or Q. So hints never
+// rely on cards the player cannot see.
+task analyse()
+{
+    static game frames[HINT_DEPTH + 1];
+    static vector<command> moves[HINT_DEPTH];
+    int next[HINT_DEPTH];
+    bool again = false;
+
+    while (true)
+    {
+        if (!again)
+        {
+            co_await changed;
+            hint_depth = 0;
+            analysing = true;
+            search_start = chrono::system_clock::now();
         }
-        else if (com == 'Q')
+
+        auto slice = chrono::steady_clock::now();
+        long start = generation;
+        frames[0] = state;
+        long nodes = 0;
+
+        for (int depth = 1; depth <= HINT_DEPTH && generation == start; depth++)
         {
-            printf(">");
-            scanf(" %i", &to);
+            command best = {0, 0, 0, 0, 0};
+            int best_score = -COUNT;
+            int level = 0;
 
-            int c1 = deck.back().value;
+            legal_moves(frames[0], moves[0]);
+            next[0] = 0;
 
-            if (final[to].size() == 0)
+            while (level >= 0 && generation == start)
             {
-                if (get_num(c1) == 1)
+                if (next[level] == (int)moves[level].size())
                 {
-                    card c = deck.back();
-                    final[to].push_back(c);
-                    deck.pop_back();
+                    level--;
+                    continue;
+                }
+
+                const command &c = moves[level][next[level]++];
+                frames[level + 1] = frames[level];
+                apply_command(frames[level + 1], c);
+
+                if (level + 1 == depth || won(frames[level + 1]) || c.com == 'n' ||
+                    frames[level + 1].deck.size() < frames[level].deck.size() ||
+                    hidden(frames[level + 1]) < hidden(frames[level]))
+                {
+                    int s = score(frames[level + 1]);
+                    if (s > best_score)
+                    {
+                        best_score = s;
+                        best = moves[0][next[0] - 1];
+                    }
+                }
+                else
+                {
+                    level++;
+                    legal_moves(frames[level], moves[level]);
+                    next[level] = 0;
                 }
-            }
-            else
-            {
-                int c2 = final[to].back().value;
 
-                if (get_num(c1) == get_num(c2) + 1 && get_suit(c1) == get_suit(c2))
+                if (++nodes % 64 == 0)
                 {
-                    card c = deck.back();
-                    final[to].push_back(c);
-                    deck.pop_back();
+                    longest_slice = max(longest_slice, since(slice));
+                    co_await loop.yield();
+                    slice = chrono::steady_clock::now();
                 }
             }
+
+            // A repeated search only redoes depths already shown
+            if (generation == start && depth > hint_depth)
+            {
+                hint = best;
+                hint_depth = depth;
+            }
         }
-        else if (com == '\n')
+
+        longest_slice = max(longest_slice, since(slice));
+
+        // Repeats count as one search, running until the game changes
+        again = load && generation == start;
+        if (again)
         {
+            co_await loop.yield();
+            continue;
         }
+
+        analysing = false;
+        last_start = search_start;
+        last_end = chrono::system_clock::now();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // -l reports input latency on exit; input lines carry send times.
+    // -b keeps the hint search busy for as long as the game runs.
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-l") == 0)
+        {
+            measure = true;
+        }
+        else if (strcmp(argv[i], "-b") == 0)
+        {
+            load = true;
+        }
+    }
+
+    deal(state, [] { return rand(); });
+
+    loop.spawn(read_input());
+    loop.spawn(play_input());
+    loop.spawn(render());
+    loop.spawn(play_safe());
+    loop.spawn(analyse(), true);
+
+    moved.set();
+    loop.run();
+
+    if (measure)
+    {
+        report_latency("idle", idle_latency);
+        report_latency("analysing", busy_latency);
+        fprintf(stderr, "longest search slice %.3f ms\n", longest_slice);
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,701 @@
+#ifndef SOLITAIRE_H
+#define SOLITAIRE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <memory_resource>
+#include <vector>
+
+constexpr int COUNT = 52;
+
+struct card
+{
+    int value;
+    bool visible;
+};
+
+typedef std::pmr::vector<card> pile;
+
+struct game;
+
+// Where every card is and which moves it takes part in, kept up to date by
+// apply_command() so legal_moves() only visits moves that exist.
+//
+// Tableau moves are indexed by the card being built on: for each value 2..13
+// and suit parity there are two such cards and two of the other parity one
+// lower that can go on them, so four pairs. A pair's bit is set in faceup_pairs
+// while both cards are face up in different stacks (an M move), and in
+// top_pairs while both are on top (an m move). Moving or turning up a card
+// touches at most its four pairs.
+struct move_index
+{
+    // Pile of each card: 0 the deck, 1..6 the stacks, 7..10 the final piles
+    int8_t where[COUNT];
+    // Position of each card within its stack
+    uint8_t pos[COUNT];
+    // Cards on top of a stack, and face up in one
+    uint64_t tops;
+    uint64_t faceup;
+    // The card each suit's final pile takes next, and that pile (-1: none yet)
+    uint64_t next_home;
+    int8_t home[4];
+    // Cards in a stack that are face down, or not lower than the card under
+    // them: while any are left the stacks cannot simply be played out
+    uint64_t unsorted;
+
+    uint64_t faceup_pairs[2];
+    uint64_t top_pairs[2];
+
+    void rebuild(const game &g);
+
+    // Record stack x from position start up, after cards there moved
+    void restack(const game &g, int x, int start);
+    // Record value going onto final pile t
+    void send_home(int value, int t);
+    // Work out the top and face-up bits, and the pairs, for value again
+    void refresh(const game &g, int value);
+
+    static int pair_id(int c1, int c2);
+    static void pair_cards(int id, int &c1, int &c2);
+    void update_pair(int c1, int c2);
+};
+
+// One game: the stock, 6 tableau stacks and 4 final piles. Every pile is
+// carved out of the game's own buffer with room for the whole pack, so
+// playing never touches the heap and the game is freed in one piece.
+struct game
+{
+    game()
+        : arena(buffer, sizeof(buffer), std::pmr::null_memory_resource()),
+          deck(&arena),
+          stacks{pile(&arena), pile(&arena), pile(&arena), pile(&arena), pile(&arena), pile(&arena)},
+          final{pile(&arena), pile(&arena), pile(&arena), pile(&arena)}
+    {
+        deck.reserve(COUNT);
+        for (int x = 0; x < 6; x++)
+        {
+            stacks[x].reserve(COUNT);
+        }
+        for (int t = 0; t < 4; t++)
+        {
+            final[t].reserve(COUNT);
+        }
+        index.rebuild(*this);
+    }
+
+    game(const game &other) : game()
+    {
+        *this = other;
+    }
+
+    // Copies the cards only; each game keeps its own buffer
+    game &operator=(const game &other)
+    {
+        index = other.index;
+        deck = other.deck;
+        for (int x = 0; x < 6; x++)
+        {
+            stacks[x] = other.stacks[x];
+        }
+        for (int t = 0; t < 4; t++)
+        {
+            final[t] = other.final[t];
+        }
+        return *this;
+    }
+
+    alignas(card) unsigned char buffer[11 * COUNT * sizeof(card)];
+    std::pmr::monotonic_buffer_resource arena;
+
+    pile deck;
+    pile stacks[6];
+    pile final[4];
+
+    move_index index;
+};
+
+// Printed form of a card, kept off the heap
+struct card_text
+{
+    char text[16];
+};
+
+// A player command, as typed at the prompt.
+//   m from to          top card of stack onto stack
+//   M from to loc1 loc2 run starting at loc1 into stack at loc2
+//   n                  rotate the deck
+//   p to               deck top onto stack
+//   P from to          top card of stack onto final pile
+//   Q to               deck top onto final pile
+struct command
+{
+    char com;
+    int from;
+    int to;
+    int loc1;
+    int loc2;
+};
+
+inline int get_suit(int t)
+{
+    return t / 13;
+}
+
+inline int get_num(int t)
+{
+    return (t % 13) + 1;
+}
+
+// Display card value
+inline card_text display_card(card c)
+{
+    card_text result;
+
+    if (c.visible)
+    {
+        int t = c.value;
+        snprintf(result.text, sizeof(result.text), "%i:%2d", get_suit(t), get_num(t));
+    }
+    else
+    {
+        snprintf(result.text, sizeof(result.text), "X:XX");
+    }
+
+    return result;
+}
+
+// c1 may be placed on c2: alternating suit parity, one value lower
+inline bool builds_on(int c1, int c2)
+{
+    return (get_suit(c1) + 1) % 2 == get_suit(c2) % 2 && get_num(c2) - get_num(c1) == 1;
+}
+
+// c1 may be placed on the final pile f
+inline bool fits_final(int c1, const pile &f)
+{
+    if (f.size() == 0)
+    {
+        return get_num(c1) == 1;
+    }
+
+    int c2 = f.back().value;
+    return get_num(c1) == get_num(c2) + 1 && get_suit(c1) == get_suit(c2);
+}
+
+inline bool valid_stack(int i)
+{
+    return i >= 0 && i < 6;
+}
+
+inline bool valid_final(int i)
+{
+    return i >= 0 && i < 4;
+}
+
+inline int move_index::pair_id(int c1, int c2)
+{
+    int r2 = get_num(c2);
+    int q2 = get_suit(c2) % 2;
+    return ((r2 - 2) * 2 + q2) * 4 + (get_suit(c2) / 2) * 2 + get_suit(c1) / 2;
+}
+
+inline void move_index::pair_cards(int id, int &c1, int &c2)
+{
+    int r2 = id / 8 + 2;
+    int q2 = (id / 4) % 2;
+    c2 = (q2 + 2 * ((id / 2) % 2)) * 13 + r2 - 1;
+    c1 = (1 - q2 + 2 * (id % 2)) * 13 + r2 - 2;
+}
+
+inline void move_index::update_pair(int c1, int c2)
+{
+    int id = pair_id(c1, c2);
+    uint64_t bit = 1ull << (id % 64);
+    bool apart = where[c1] != where[c2];
+
+    if (apart && (faceup >> c1 & 1) && (faceup >> c2 & 1))
+    {
+        faceup_pairs[id / 64] |= bit;
+    }
+    else
+    {
+        faceup_pairs[id / 64] &= ~bit;
+    }
+
+    if (apart && (tops >> c1 & 1) && (tops >> c2 & 1))
+    {
+        top_pairs[id / 64] |= bit;
+    }
+    else
+    {
+        top_pairs[id / 64] &= ~bit;
+    }
+}
+
+inline void move_index::refresh(const game &g, int value)
+{
+    uint64_t bit = 1ull << value;
+    tops &= ~bit;
+    faceup &= ~bit;
+    unsorted &= ~bit;
+
+    int w = where[value];
+    if (w >= 1 && w <= 6)
+    {
+        const pile &s = g.stacks[w - 1];
+        int i = pos[value];
+        if (i == (int)s.size() - 1)
+        {
+            tops |= bit;
+        }
+        if (s[i].visible)
+        {
+            faceup |= bit;
+        }
+        if (!s[i].visible || (i > 0 && get_num(value) >= get_num(s[i - 1].value)))
+        {
+            unsorted |= bit;
+        }
+    }
+
+    // The cards value can go on, and the cards that can go on value
+    int r = get_num(value);
+    int other = (get_suit(value) + 1) % 2;
+    if (r < 13)
+    {
+        update_pair(value, other * 13 + r);
+        update_pair(value, (other + 2) * 13 + r);
+    }
+    if (r > 1)
+    {
+        update_pair(other * 13 + r - 2, value);
+        update_pair((other + 2) * 13 + r - 2, value);
+    }
+}
+
+inline void move_index::restack(const game &g, int x, int start)
+{
+    const pile &s = g.stacks[x];
+
+    for (int i = start; i < (int)s.size(); i++)
+    {
+        where[s[i].value] = x + 1;
+        pos[s[i].value] = i;
+        refresh(g, s[i].value);
+    }
+
+    // The card below may have become, or stopped being, the top
+    if (start > 0 && start <= (int)s.size())
+    {
+        refresh(g, s[start - 1].value);
+    }
+}
+
+inline void move_index::send_home(int value, int t)
+{
+    where[value] = 7 + t;
+    home[get_suit(value)] = t;
+
+    next_home &= ~(1ull << value);
+    if (get_num(value) < 13)
+    {
+        next_home |= 1ull << (value + 1);
+    }
+}
+
+inline void move_index::rebuild(const game &g)
+{
+    tops = 0;
+    faceup = 0;
+    next_home = 0;
+    unsorted = 0;
+    faceup_pairs[0] = faceup_pairs[1] = 0;
+    top_pairs[0] = top_pairs[1] = 0;
+
+    for (int v = 0; v < COUNT; v++)
+    {
+        where[v] = -1;
+        pos[v] = 0;
+    }
+    for (const card &c : g.deck)
+    {
+        where[c.value] = 0;
+    }
+    for (int s = 0; s < 4; s++)
+    {
+        home[s] = -1;
+        next_home |= 1ull << (s * 13);
+    }
+    for (int t = 0; t < 4; t++)
+    {
+        for (const card &c : g.final[t])
+        {
+            send_home(c.value, t);
+        }
+    }
+    for (int x = 0; x < 6; x++)
+    {
+        restack(g, x, 0);
+    }
+}
+
+// Turn up the top card of every stack and of the deck, as display() does
+inline void reveal(game &g)
+{
+    for (int x = 0; x < 6; x++)
+    {
+        if (g.stacks[x].size() > 0 && !g.stacks[x].back().visible)
+        {
+            g.stacks[x].back().visible = true;
+            g.index.refresh(g, g.stacks[x].back().value);
+        }
+    }
+
+    if (g.deck.size() > 0)
+    {
+        g.deck.back().visible = true;
+    }
+}
+
+inline bool won(const game &g)
+{
+    int count = 0;
+    for (int t = 0; t < 4; t++)
+    {
+        count += g.final[t].size();
+    }
+    return count == COUNT;
+}
+
+// Shuffle and deal a fresh game; next() supplies random ints like rand()
+template <typename Random>
+void deal(game &g, Random &&next)
+{
+    g.deck.clear();
+    for (int x = 0; x < 6; x++)
+    {
+        g.stacks[x].clear();
+    }
+    for (int t = 0; t < 4; t++)
+    {
+        g.final[t].clear();
+    }
+
+    // Initial deck
+    for (int t = 0; t < COUNT; t++)
+    {
+        card c = {t, false};
+        g.deck.push_back(c);
+    }
+
+    // Shuffle
+    for (int t = 0; t < COUNT; t++)
+    {
+        int move = next() % COUNT;
+        card c = g.deck.at(move);
+        g.deck.erase(g.deck.begin() + move);
+        g.deck.push_back(c);
+    }
+
+    for (int x = 0; x < 6; x++)
+    {
+        for (int t = 0; t < x + 1; t++)
+        {
+            g.stacks[x].push_back(g.deck.back());
+            g.deck.pop_back();
+        }
+    }
+
+    g.index.rebuild(g);
+    reveal(g);
+}
+
+// Apply one command. Returns the code shown by display_code(), 0 if none.
+// Commands naming missing piles, cards or positions are ignored, as in
+// ansi-solitaire.c.
+inline int apply_command(game &g, const command &c)
+{
+    int code = 0;
+
+    if (c.com == 'm')
+    {
+        if (valid_stack(c.from) && valid_stack(c.to) &&
+            g.stacks[c.from].size() > 0 && g.stacks[c.to].size() > 0)
+        {
+            int c1 = g.stacks[c.from].back().value;
+            int c2 = g.stacks[c.to].back().value;
+
+            if ((get_suit(c1) + 1) % 2 == get_suit(c2) % 2)
+            {
+                if (get_num(c2) - get_num(c1) == 1)
+                {
+                    g.stacks[c.from].pop_back();
+                    g.stacks[c.to].push_back({c1, true});
+                    g.index.restack(g, c.from, g.stacks[c.from].size());
+                    g.index.restack(g, c.to, g.stacks[c.to].size() - 1);
+                }
+                else
+                {
+                    code = 1;
+                }
+            }
+            else
+            {
+                code = 2;
+            }
+        }
+    }
+    else if (c.com == 'M')
+    {
+        // A run cannot be inserted into its own stack: the loop below would
+        // never shrink the source.
+        if (valid_stack(c.from) && valid_stack(c.to) && c.from != c.to &&
+            c.loc1 >= 0 && c.loc1 < (int)g.stacks[c.from].size() &&
+            c.loc2 >= 0 && c.loc2 < (int)g.stacks[c.to].size())
+        {
+            pile &from = g.stacks[c.from];
+            pile &to = g.stacks[c.to];
+
+            if (builds_on(from.at(c.loc1).value, to.at(c.loc2).value))
+            {
+                while ((int)from.size() > c.loc1)
+                {
+                    card f = from.at(c.loc1);
+                    to.insert(to.begin() + c.loc2, f);
+                    from.erase(from.begin() + c.loc1);
+                }
+                g.index.restack(g, c.from, c.loc1);
+                g.index.restack(g, c.to, c.loc2);
+            }
+        }
+    }
+    else if (c.com == 'n')
+    {
+        if (g.deck.size() > 0)
+        {
+            card v = g.deck.back();
+            g.deck.pop_back();
+            g.deck.insert(g.deck.begin(), v);
+        }
+    }
+    else if (c.com == 'p')
+    {
+        if (valid_stack(c.to) && g.deck.size() > 0 && g.stacks[c.to].size() > 0)
+        {
+            int c1 = g.deck.back().value;
+            int c2 = g.stacks[c.to].back().value;
+
+            if ((get_suit(c1) + 1) % 2 == get_suit(c2) % 2)
+            {
+                if (get_num(c2) - get_num(c1) == 1)
+                {
+                    g.deck.pop_back();
+                    g.stacks[c.to].push_back({c1, true});
+                    g.index.restack(g, c.to, g.stacks[c.to].size() - 1);
+                }
+                else
+                {
+                    code = 4;
+                }
+            }
+            else
+            {
+                code = 3;
+            }
+        }
+    }
+    else if (c.com == 'P')
+    {
+        if (valid_stack(c.from) && valid_final(c.to) && g.stacks[c.from].size() > 0)
+        {
+            if (fits_final(g.stacks[c.from].back().value, g.final[c.to]))
+            {
+                g.final[c.to].push_back(g.stacks[c.from].back());
+                g.stacks[c.from].pop_back();
+                g.index.send_home(g.final[c.to].back().value, c.to);
+                g.index.refresh(g, g.final[c.to].back().value);
+                g.index.restack(g, c.from, g.stacks[c.from].size());
+            }
+        }
+    }
+    else if (c.com == 'Q')
+    {
+        if (valid_final(c.to) && g.deck.size() > 0)
+        {
+            if (fits_final(g.deck.back().value, g.final[c.to]))
+            {
+                g.final[c.to].push_back(g.deck.back());
+                g.deck.pop_back();
+                g.index.send_home(g.final[c.to].back().value, c.to);
+            }
+        }
+    }
+
+    reveal(g);
+    return code;
+}
+
+// Every command that apply_command() would carry out on face-up cards.
+// Moves to an empty final pile are listed once, for the first empty pile.
+// Read off the move index, so the cost follows the number of moves found.
+inline void legal_moves(const game &g, std::vector<command> &moves)
+{
+    const move_index &ix = g.index;
+    moves.clear();
+
+    int empty_final = -1;
+    for (int t = 3; t >= 0; t--)
+    {
+        if (g.final[t].size() == 0)
+        {
+            empty_final = t;
+        }
+    }
+
+    for (int w = 0; w < 2; w++)
+    {
+        for (uint64_t bits = ix.top_pairs[w]; bits; bits &= bits - 1)
+        {
+            int c1, c2;
+            move_index::pair_cards(w * 64 + __builtin_ctzll(bits), c1, c2);
+            moves.push_back({'m', ix.where[c1] - 1, ix.where[c2] - 1, 0, 0});
+        }
+
+        for (uint64_t bits = ix.faceup_pairs[w]; bits; bits &= bits - 1)
+        {
+            int c1, c2;
+            move_index::pair_cards(w * 64 + __builtin_ctzll(bits), c1, c2);
+            moves.push_back({'M', ix.where[c1] - 1, ix.where[c2] - 1, ix.pos[c1], ix.pos[c2]});
+        }
+    }
+
+    for (uint64_t bits = ix.tops & ix.next_home; bits; bits &= bits - 1)
+    {
+        int v = __builtin_ctzll(bits);
+        int to = ix.home[get_suit(v)] >= 0 ? ix.home[get_suit(v)] : empty_final;
+        moves.push_back({'P', ix.where[v] - 1, to, 0, 0});
+    }
+
+    if (g.deck.size() > 0)
+    {
+        int c1 = g.deck.back().value;
+
+        // The cards the deck top can go on
+        int r = get_num(c1);
+        int other = (get_suit(c1) + 1) % 2;
+        if (r < 13)
+        {
+            for (int c2 : {other * 13 + r, (other + 2) * 13 + r})
+            {
+                if (ix.tops >> c2 & 1)
+                {
+                    moves.push_back({'p', 0, ix.where[c2] - 1, 0, 0});
+                }
+            }
+        }
+
+        if (ix.next_home >> c1 & 1)
+        {
+            int to = ix.home[get_suit(c1)] >= 0 ? ix.home[get_suit(c1)] : empty_final;
+            moves.push_back({'Q', 0, to, 0, 0});
+        }
+
+        if (g.deck.size() > 1)
+        {
+            moves.push_back({'n', 0, 0, 0, 0});
+        }
+    }
+}
+
+// The same moves as legal_moves(), found by trying every pile pair and
+// every face-up card. Kept as a reference for checking the index.
+inline void scan_moves(const game &g, std::vector<command> &moves)
+{
+    moves.clear();
+
+    int empty_final = -1;
+    for (int t = 3; t >= 0; t--)
+    {
+        if (g.final[t].size() == 0)
+        {
+            empty_final = t;
+        }
+    }
+
+    for (int from = 0; from < 6; from++)
+    {
+        const pile &f = g.stacks[from];
+        if (f.size() == 0)
+        {
+            continue;
+        }
+
+        int c1 = f.back().value;
+
+        for (int to = 0; to < 6; to++)
+        {
+            const pile &s = g.stacks[to];
+            if (to == from || s.size() == 0)
+            {
+                continue;
+            }
+
+            if (builds_on(c1, s.back().value))
+            {
+                moves.push_back({'m', from, to, 0, 0});
+            }
+
+            for (int loc1 = 0; loc1 < (int)f.size(); loc1++)
+            {
+                if (!f[loc1].visible)
+                {
+                    continue;
+                }
+
+                for (int loc2 = 0; loc2 < (int)s.size(); loc2++)
+                {
+                    if (s[loc2].visible && builds_on(f[loc1].value, s[loc2].value))
+                    {
+                        moves.push_back({'M', from, to, loc1, loc2});
+                    }
+                }
+            }
+        }
+
+        for (int to = 0; to < 4; to++)
+        {
+            if ((g.final[to].size() > 0 || to == empty_final) && fits_final(c1, g.final[to]))
+            {
+                moves.push_back({'P', from, to, 0, 0});
+            }
+        }
+    }
+
+    if (g.deck.size() > 0)
+    {
+        int c1 = g.deck.back().value;
+
+        for (int to = 0; to < 6; to++)
+        {
+            if (g.stacks[to].size() > 0 && builds_on(c1, g.stacks[to].back().value))
+            {
+                moves.push_back({'p', 0, to, 0, 0});
+            }
+        }
+
+        for (int to = 0; to < 4; to++)
+        {
+            if ((g.final[to].size() > 0 || to == empty_final) && fits_final(c1, g.final[to]))
+            {
+                moves.push_back({'Q', 0, to, 0, 0});
+            }
+        }
+
+        if (g.deck.size() > 1)
+        {
+            moves.push_back({'n', 0, 0, 0, 0});
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <random>
+
+#include "solitaire.h"
+#include "solver.h"
+#include "transposition.h"
+
+using namespace std;
+
+void usage()
+{
+    fprintf(stderr,
+            "usage: solve [-n deals] [-d depth] [-l nodes per deal] [-m table MB]\n"
+            "             [-r depth|age] [-s spill directory] [-S spill MB]\n");
+}
+
+int main(int argc, char **argv)
+{
+    int deals = 100;
+    int max_depth = 200;
+    long node_limit = 1000000;
+    size_t table_mb = 64;
+    size_t spill_mb = 1024;
+    const char *spill_dir = nullptr;
+    transposition_table::replacement policy = transposition_table::DEPTH_PREFERRED;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:d:l:m:r:s:S:")) != -1)
+    {
+        if (opt == 'n')
+        {
+            deals = atoi(optarg);
+        }
+        else if (opt == 'd')
+        {
+            max_depth = atoi(optarg);
+        }
+        else if (opt == 'l')
+        {
+            node_limit = atol(optarg);
+        }
+        else if (opt == 'm')
+        {
+            table_mb = atol(optarg);
+        }
+        else if (opt == 'r')
+        {
+            policy = strcmp(optarg, "age") == 0 ? transposition_table::AGE_PREFERRED
+                                                : transposition_table::DEPTH_PREFERRED;
+        }
+        else if (opt == 's')
+        {
+            spill_dir = optarg;
+        }
+        else if (opt == 'S')
+        {
+            spill_mb = atol(optarg);
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (max_depth < 1 || max_depth >= 0xFFFF)
+    {
+        usage();
+        return 1;
+    }
+
+    transposition_table table(table_mb << 20, policy);
+    if (!table.ok())
+    {
+        return 1;
+    }
+    if (spill_dir && !table.open_spill(spill_dir, spill_mb << 20))
+    {
+        return 1;
+    }
+
+    solver s(table, max_depth, node_limit);
+    game g;
+    int count[3] = {0, 0, 0};
+    long nodes = 0;
+
+    auto start = chrono::steady_clock::now();
+
+    for (int d = 0; d < deals; d++)
+    {
+        // The same deals as tournament
+        minstd_rand rng(d + 1);
+        deal(g, [&rng] { return (int)(rng() >> 1); });
+
+        solver::result r = s.solve(g);
+        count[r]++;
+        nodes += s.nodes;
+
+        printf("deal %5i  %-7s %10li nodes\n", d, r == solver::WON ? "won" : r == solver::LOST ? "lost" : "unknown",
+               s.nodes);
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    const transposition_table::statistics &st = table.stats();
+
+    printf("\n%i won, %i lost, %i unknown; %li nodes, %.0f nodes/sec\n", count[solver::WON], count[solver::LOST],
+           count[solver::UNKNOWN], nodes, seconds > 0 ? nodes / seconds : 0.0);
+    printf("table: %zu of %zu bytes used, %.1f%% hit rate (%li RAM, %li spill of %li probes)\n",
+           table.used_bytes(), table.capacity_bytes(),
+           st.probes ? 100.0 * (st.hits + st.spill_hits) / st.probes : 0.0, st.hits, st.spill_hits, st.probes);
+    printf("       %li stores, %li evictions", st.stores, st.evictions);
+    if (spill_dir)
+    {
+        printf(", %li spilled to a %zu byte file, %li lost from it", st.spills, table.spill_bytes(),
+               st.spill_evictions);
+    }
+    printf("\n");
+
+    return 0;
+}
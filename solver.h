@@ -0,0 +1,141 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <vector>
+
+#include "solitaire.h"
+#include "autoplay.h"
+#include "transposition.h"
+
+// Depth-first search for a winning line, with every card the player could
+// see turned up as it is reached. Safe final moves are made automatically
+// after every move, and positions already searched at least as deep are
+// skipped through the transposition table.
+class solver
+{
+public:
+    enum result
+    {
+        LOST,    // every line was searched and none wins
+        WON,
+        UNKNOWN, // the depth or node limit cut the search short
+    };
+
+    solver(transposition_table &table, int max_depth, long node_limit)
+        : table(table), max_depth(max_depth), node_limit(node_limit),
+          frames(max_depth + 1), engines(max_depth + 1), moves(max_depth), path(max_depth + 1)
+    {
+    }
+
+    result solve(const game &g)
+    {
+        table.new_search();
+        nodes = 0;
+
+        frames[0] = g;
+        engines[0].reset(frames[0]);
+        engines[0].run(frames[0]);
+
+        bool cut = false, looped = false;
+        if (search(0, cut, looped))
+        {
+            return WON;
+        }
+        return cut ? UNKNOWN : LOST;
+    }
+
+    long nodes = 0;
+
+private:
+    // Stored as the depth of a position searched to the end
+    static constexpr int EXHAUSTED = 0xFFFF;
+
+    // Stored as the value of a position not searched to the end: why not.
+    // A line that looped is only known not to win on the path it was
+    // searched from; the entry is still used on other paths, as an
+    // approximation. Lines the node limit ended are not stored at all.
+    static constexpr uint32_t DEPTH_CUT = 1;
+    static constexpr uint32_t LOOPED = 2;
+
+    // True if frames[level] can be won. cut is set when a limit, rather
+    // than the rules, ended some line below; looped when a line below came
+    // back to a position on the path, so the result holds only for this path.
+    bool search(int level, bool &cut, bool &looped)
+    {
+        const game &g = frames[level];
+        if (won(g))
+        {
+            return true;
+        }
+
+        int remaining = max_depth - level;
+        if (remaining == 0 || nodes >= node_limit)
+        {
+            cut = true;
+            return false;
+        }
+
+        uint64_t key = position_key(g);
+        uint32_t value;
+        int depth;
+        if (table.probe(key, value, depth) && depth >= remaining)
+        {
+            cut = cut || (value & DEPTH_CUT);
+            looped = looped || (value & LOOPED);
+            return false;
+        }
+
+        // Going round in a circle never helps
+        for (int i = 0; i < level; i++)
+        {
+            if (path[i] == key)
+            {
+                looped = true;
+                return false;
+            }
+        }
+        path[level] = key;
+
+        nodes++;
+
+        bool below = false, looped_below = false;
+        legal_moves(g, moves[level]);
+        for (const command &c : moves[level])
+        {
+            game &next = frames[level + 1];
+            next = g;
+            apply_command(next, c);
+
+            autoplay &engine = engines[level + 1];
+            engine = engines[level];
+            engine.note(next, c);
+            engine.run(next);
+
+            if (search(level + 1, below, looped_below))
+            {
+                return true;
+            }
+        }
+
+        // The node limit was reached below; the next deal will search on
+        if (nodes < node_limit)
+        {
+            uint32_t why = (below ? DEPTH_CUT : 0) | (looped_below ? LOOPED : 0);
+            table.store(key, why, why ? remaining : EXHAUSTED);
+        }
+        cut = cut || below;
+        looped = looped || looped_below;
+        return false;
+    }
+
+    transposition_table &table;
+    int max_depth;
+    long node_limit;
+
+    std::vector<game> frames;
+    std::vector<autoplay> engines;
+    std::vector<std::vector<command>> moves;
+    std::vector<uint64_t> path;
+};
+
+#endif
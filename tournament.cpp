@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <new>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "solitaire.h"
+#include "policy.h"
+
+using namespace std;
+
+// Heap allocations made by this thread, to report allocations per game
+thread_local long allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    if (void *p = malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// Totals for one policy over the deals one thread played
+struct result
+{
+    long games;
+    long wins;
+    long moves;
+    long allocations;
+};
+
+// Play deals first, first + step, ... below count. Each thread owns its
+// games and policy, and adds up its totals locally: out sits next to the
+// other threads' results and is written once, at the end.
+void play(const policy_entry &entry, int first, int step, int count, int max_moves, result &out)
+{
+    unique_ptr<policy> p = entry.make(first);
+
+    result total = {0, 0, 0, 0};
+
+    for (int d = first; d < count; d += step)
+    {
+        // A fresh game per deal, as a server would create them
+        long before = allocations;
+        game g;
+        game_view v(g);
+
+        // Deal d, and the policy's choices on it, are the same however many
+        // threads play
+        minstd_rand rng(d + 1);
+        deal(g, [&rng] { return (int)(rng() >> 1); });
+        p->new_game(d + 1);
+
+        int moves = 0;
+        while (moves < max_moves && !won(g))
+        {
+            command c = p->choose(v);
+            if (c.com == 0)
+            {
+                break;
+            }
+
+            apply_command(g, c);
+            moves++;
+        }
+
+        total.games++;
+        total.moves += moves;
+        if (won(g))
+        {
+            total.wins++;
+        }
+        total.allocations += allocations - before;
+    }
+
+    out = total;
+}
+
+int main(int argc, char **argv)
+{
+    int deals = argc > 1 ? atoi(argv[1]) : 10000;
+    int max_moves = argc > 2 ? atoi(argv[2]) : 1000;
+    int threads = argc > 3 ? atoi(argv[3]) : thread::hardware_concurrency();
+
+    if (threads < 1)
+    {
+        threads = 1;
+    }
+
+    printf("%i deals, %i moves max, %i threads\n\n", deals, max_moves, threads);
+    printf("%-12s %10s %12s %14s %12s\n", "policy", "win rate", "avg moves", "games/sec", "allocs/game");
+
+    for (const policy_entry &entry : builtin_policies())
+    {
+        vector<result> results(threads);
+        vector<thread> workers;
+
+        auto start = chrono::steady_clock::now();
+
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back(play, cref(entry), t, threads, deals, max_moves, ref(results[t]));
+        }
+        for (thread &w : workers)
+        {
+            w.join();
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        result total = {0, 0, 0, 0};
+        for (const result &r : results)
+        {
+            total.games += r.games;
+            total.wins += r.wins;
+            total.moves += r.moves;
+            total.allocations += r.allocations;
+        }
+
+        printf("%-12s %9.2f%% %12.1f %14.0f %12.1f\n", entry.name.c_str(),
+               total.games ? 100.0 * total.wins / total.games : 0.0,
+               total.games ? (double)total.moves / total.games : 0.0,
+               seconds > 0 ? total.games / seconds : 0.0,
+               total.games ? (double)total.allocations / total.games : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,391 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string>
+
+#include "solitaire.h"
+
+// 64-bit Zobrist key for a position. The final piles only count by height
+// per suit, so the same cards home on different piles hash alike.
+inline uint64_t position_key(const game &g)
+{
+    struct keys
+    {
+        uint64_t place[7][COUNT][COUNT]; // pile (deck, stacks), index, card
+        uint64_t visible[COUNT];
+        uint64_t home[4][14];
+
+        keys()
+        {
+            uint64_t x = 0x9E3779B97F4A7C15ull;
+            auto next = [&x] {
+                // splitmix64
+                uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+                return z ^ (z >> 31);
+            };
+
+            for (auto &p : place)
+            {
+                for (auto &i : p)
+                {
+                    for (uint64_t &k : i)
+                    {
+                        k = next();
+                    }
+                }
+            }
+            for (uint64_t &k : visible)
+            {
+                k = next();
+            }
+            for (auto &s : home)
+            {
+                for (uint64_t &k : s)
+                {
+                    k = next();
+                }
+            }
+        }
+    };
+    static const keys z;
+
+    uint64_t key = 0;
+
+    for (int p = 0; p < 7; p++)
+    {
+        const pile &s = p == 0 ? g.deck : g.stacks[p - 1];
+        for (int i = 0; i < (int)s.size(); i++)
+        {
+            key ^= z.place[p][i][s[i].value];
+            if (s[i].visible)
+            {
+                key ^= z.visible[s[i].value];
+            }
+        }
+    }
+
+    for (int t = 0; t < 4; t++)
+    {
+        if (g.final[t].size() > 0)
+        {
+            int value = g.final[t].back().value;
+            key ^= z.home[get_suit(value)][get_num(value)];
+        }
+    }
+
+    return key;
+}
+
+// A fixed-size hash table of searched positions. Memory is allocated once
+// up front and never grows: when a bucket is full an entry is replaced,
+// chosen by depth or by age. Replaced entries can go to an optional second
+// tier in a memory-mapped file, which the OS pages out instead of running
+// out of RAM.
+class transposition_table
+{
+public:
+    enum replacement
+    {
+        DEPTH_PREFERRED, // keep deep entries, then recent ones
+        AGE_PREFERRED,   // keep recent entries, then deep ones
+    };
+
+    struct entry
+    {
+        uint64_t key;
+        uint32_t value;
+        uint16_t depth;
+        uint16_t age;
+    };
+
+    // One cache line of entries
+    struct alignas(64) bucket
+    {
+        entry slot[4];
+    };
+
+    struct statistics
+    {
+        long probes;
+        long hits;
+        long spill_hits;
+        long stores;
+        long evictions;
+        long spills;
+        long spill_evictions;
+    };
+
+    // Use at most bytes of RAM; rounded down to a power of two buckets.
+    // Check ok() before use: the memory may not be there.
+    transposition_table(size_t bytes, replacement policy = DEPTH_PREFERRED) : policy(policy)
+    {
+        size_t count = 1;
+        while (count * 2 * sizeof(bucket) <= bytes)
+        {
+            count *= 2;
+        }
+
+        buckets = (bucket *)aligned_alloc(alignof(bucket), count * sizeof(bucket));
+        if (!buckets)
+        {
+            perror("transposition table");
+            return;
+        }
+
+        mask = count - 1;
+        clear();
+    }
+
+    ~transposition_table()
+    {
+        free(buckets);
+        close_spill();
+    }
+
+    bool ok() const
+    {
+        return buckets != nullptr;
+    }
+
+    transposition_table(const transposition_table &) = delete;
+    transposition_table &operator=(const transposition_table &) = delete;
+
+    // Back the table with a new file of the given size in directory dir.
+    // Returns false, leaving the table RAM-only, if the file cannot be
+    // created or mapped. No existing file is ever touched.
+    bool open_spill(const char *dir, size_t bytes)
+    {
+        close_spill();
+
+        size_t count = 1;
+        while (count * 2 * sizeof(bucket) <= bytes)
+        {
+            count *= 2;
+        }
+
+        std::string path = std::string(dir) + "/transposition.XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd < 0)
+        {
+            perror(dir);
+            return false;
+        }
+
+        // Nothing else needs the name; the space goes when the map does
+        unlink(path.c_str());
+
+        // The new file reads as zeros: every slot starts empty
+        void *p = MAP_FAILED;
+        if (ftruncate(fd, count * sizeof(bucket)) == 0)
+        {
+            p = mmap(nullptr, count * sizeof(bucket), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (p == MAP_FAILED)
+        {
+            perror(path.c_str());
+            close(fd);
+            return false;
+        }
+
+        spill = (bucket *)p;
+        spill_mask = count - 1;
+        spill_fd = fd;
+        return true;
+    }
+
+    void clear()
+    {
+        for (size_t i = 0; i <= mask; i++)
+        {
+            buckets[i] = bucket();
+        }
+        used = 0;
+        counters = statistics();
+    }
+
+    // Entries stored from now on count as newer than everything before
+    void new_search()
+    {
+        age++;
+    }
+
+    bool probe(uint64_t key, uint32_t &value, int &depth)
+    {
+        key |= 1;
+        counters.probes++;
+
+        if (entry *e = find(buckets[(key >> 1) & mask], key))
+        {
+            counters.hits++;
+            value = e->value;
+            depth = e->depth;
+            return true;
+        }
+
+        if (spill)
+        {
+            if (entry *e = find(spill[(key >> 1) & spill_mask], key))
+            {
+                counters.spill_hits++;
+                value = e->value;
+                depth = e->depth;
+
+                // Bring it back into RAM; this may push another entry out
+                entry found = *e;
+                e->key = 0;
+                insert(found);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void store(uint64_t key, uint32_t value, int depth)
+    {
+        counters.stores++;
+        insert({key | 1, value, (uint16_t)depth, age});
+    }
+
+    const statistics &stats() const
+    {
+        return counters;
+    }
+
+    // RAM taken by the table itself and by the entries in use
+    size_t capacity_bytes() const { return (mask + 1) * sizeof(bucket); }
+    size_t used_bytes() const { return used * sizeof(entry); }
+    size_t spill_bytes() const { return spill ? (spill_mask + 1) * sizeof(bucket) : 0; }
+
+private:
+    // Keys are stored with the low bit set so 0 always means empty; the
+    // bits above it pick the bucket
+    static entry *find(bucket &b, uint64_t key)
+    {
+        for (entry &e : b.slot)
+        {
+            if (e.key == key)
+            {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+    // How much an entry is worth keeping; the lowest in a bucket goes
+    int worth(const entry &e) const
+    {
+        int stale = (uint16_t)(age - e.age);
+        if (stale > 255)
+        {
+            stale = 255;
+        }
+
+        if (policy == AGE_PREFERRED)
+        {
+            return (255 - stale) * 65536 + e.depth;
+        }
+        return e.depth * 256 + (255 - stale);
+    }
+
+    // Put e in b, returning the entry it displaced (key 0 if none)
+    entry place(bucket &b, const entry &e, bool &added)
+    {
+        entry *victim = nullptr;
+        added = false;
+
+        for (entry &s : b.slot)
+        {
+            if (s.key == e.key)
+            {
+                // Same position: keep whichever search went deeper
+                if (e.depth >= s.depth || s.age != e.age)
+                {
+                    s = e;
+                }
+                return entry();
+            }
+            if (s.key == 0 && !victim)
+            {
+                victim = &s;
+            }
+        }
+
+        if (victim)
+        {
+            *victim = e;
+            added = true;
+            return entry();
+        }
+
+        victim = &b.slot[0];
+        for (entry &s : b.slot)
+        {
+            if (worth(s) < worth(*victim))
+            {
+                victim = &s;
+            }
+        }
+
+        entry old = *victim;
+        *victim = e;
+        return old;
+    }
+
+    void insert(const entry &e)
+    {
+        bool added;
+        entry old = place(buckets[(e.key >> 1) & mask], e, added);
+        if (added)
+        {
+            used++;
+        }
+        if (old.key == 0)
+        {
+            return;
+        }
+
+        counters.evictions++;
+
+        if (spill)
+        {
+            counters.spills++;
+            entry lost = place(spill[(old.key >> 1) & spill_mask], old, added);
+            if (lost.key != 0)
+            {
+                counters.spill_evictions++;
+            }
+        }
+    }
+
+    void close_spill()
+    {
+        if (spill)
+        {
+            munmap(spill, (spill_mask + 1) * sizeof(bucket));
+            close(spill_fd);
+            spill = nullptr;
+        }
+    }
+
+    replacement policy;
+    bucket *buckets;
+    size_t mask = 0;
+    size_t used = 0;
+    uint16_t age = 0;
+
+    bucket *spill = nullptr;
+    size_t spill_mask = 0;
+    int spill_fd = -1;
+
+    statistics counters;
+};
+
+#endif